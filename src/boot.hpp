@@ -0,0 +1,74 @@
+#pragma once
+/*
+ * Boot timeline - millis() since power on at which each boot stage finished.
+ * Display, SD log and OBD link are brought up in parallel, so each stage has
+ * its own slot written once by whichever task finishes it.
+ */
+#include "Arduino.h"
+
+enum BootStage {
+    BOOT_SETUP_STARTED,
+    BOOT_DISPLAY_READY,
+    BOOT_LOG_READY,
+    BOOT_SD_FAILED,
+    BOOT_OBD_CONNECTED,
+    BOOT_FIRST_SPEED,
+    BOOT_STAGE_COUNT
+};
+
+static const char *bootStageNames[BOOT_STAGE_COUNT] = {
+    "setup",
+    "display",
+    "log",
+    "sd failed",
+    "obd",
+    "first speed",
+};
+
+// Names of the log entries, the first speed is logged as time-to-first-speed
+static const char *bootStageLogNames[BOOT_STAGE_COUNT] = {
+    "boot_setup",
+    "boot_display",
+    "boot_log",
+    "boot_sdfail",
+    "boot_obd",
+    "ttfs",
+};
+
+volatile unsigned long bootStageMillis[BOOT_STAGE_COUNT] = {0};
+volatile bool bootStageMarked[BOOT_STAGE_COUNT] = {false};
+SemaphoreHandle_t bootTimelineMutex = nullptr;
+
+// Called first thing in setup(), before any other task exists
+void boot_setup() {
+    bootTimelineMutex = xSemaphoreCreateMutex();
+}
+
+bool boot_isMarked(BootStage stage) {
+    return bootStageMarked[stage];
+}
+
+void boot_mark(BootStage stage) {
+    if (!boot_isMarked(stage)) {
+        bootStageMillis[stage] = millis();
+        bootStageMarked[stage] = true;
+    }
+}
+
+// Printed from the OBD connect task and from loop(), the mutex keeps the two from interleaving
+void boot_printTimeline() {
+    if (bootTimelineMutex != nullptr) {
+        xSemaphoreTake(bootTimelineMutex, portMAX_DELAY);
+    }
+    Serial.println("Boot timeline:");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if (!bootStageMarked[i]) {
+            Serial.printf("  %-12s -\n", bootStageNames[i]);
+        } else {
+            Serial.printf("  %-12s %lu ms\n", bootStageNames[i], bootStageMillis[i]);
+        }
+    }
+    if (bootTimelineMutex != nullptr) {
+        xSemaphoreGive(bootTimelineMutex);
+    }
+}
@@ -24,12 +24,22 @@ SerialPassthrough sketch
 
 #include "ELMduino.h"
 #include "Arduino.h"
+#include "boot.hpp"
 #include "sd.hpp"
 #include "ui.hpp"
 #include "queue.hpp"
+#include "replay.hpp"
+#include "metrics.hpp"
+#include "samples.hpp"
 
 
 #define DEBUG_WITH_SIMULATED_CAR false
+// Replays a recorded log instead of talking to the car. Speed: 1 = real time, N = N times faster, 0 = as fast as possible
+#define REPLAY_FROM_LOG false
+#define REPLAY_LOG_FILE "/1.csv"
+#define REPLAY_SPEED 1.0f
+// Queue entries kept free for the derived metrics rows a replayed batch can add
+#define REPLAY_QUEUE_RESERVE 32
 
 #define SerialELM Serial2
 ELM327 elmduino;
@@ -46,77 +56,82 @@ struct OBDTask {
 };
 
 OBDTask *currentTask = nullptr;
-unsigned long lastFuelTrimChartUpdate = 0;
-float lastStft1 = 0;
-float lastStft2 = 0;
-float lastLtft1 = 0;
-float lastLtft2 = 0;
+unsigned long lastMetricsLabelUpdate = 0;
+
+// The queue holds these until the log file exists, so field logs show where a slow boot spent its time
+void logBootTimeline() {
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if (bootStageMarked[i]) {
+            queue_addToCSVQueue(bootStageLogNames[i], (int) bootStageMillis[i]);
+        }
+    }
+}
 
 void kphTask() {
-    auto kph = elmduino.kph() + 3;
+    auto kph = elmduino.kph();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        ui_setSpeedValue(kph);
-        queue_addToCSVQueue("kph", kph);
+        kphReceived(kph);
+        if (!boot_isMarked(BOOT_FIRST_SPEED)) {
+            boot_mark(BOOT_FIRST_SPEED);
+            logBootTimeline();
+            boot_printTimeline();
+        }
     }
 }
 
 void rpmTask() {
     auto rpm = elmduino.rpm();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        queue_addToCSVQueue("rpm", rpm);
+        rpmReceived(rpm);
     }
 }
 
 void ectTask() {
     auto ect = elmduino.engineCoolantTemp();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        queue_addToCSVQueue("ect", ect);
+        ectReceived(ect);
     }
 }
 
 void absLoadTask() {
     auto absLoad = elmduino.absLoad();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        queue_addToCSVQueue("absload", absLoad);
+        absLoadReceived(absLoad);
     }
 }
 
 void engineLoadTask() {
     auto engineLoad = elmduino.engineLoad();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        queue_addToCSVQueue("engineload", engineLoad);
+        engineLoadReceived(engineLoad);
     }
 }
 
 void stft1Task() {
-    lastStft1 = elmduino.shortTermFuelTrimBank_1();
+    auto stft1 = elmduino.shortTermFuelTrimBank_1();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        ui_updateStft1Label(lastStft1);
-        queue_addToCSVQueue("stft1", lastStft1);
+        stft1Received(stft1);
     }
 }
 
 void stft2Task() {
-    lastStft2 = elmduino.shortTermFuelTrimBank_2();
+    auto stft2 = elmduino.shortTermFuelTrimBank_2();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        ui_updateStft2Label(lastStft2);
-        queue_addToCSVQueue("stft2", lastStft2);
+        stft2Received(stft2);
     }
 }
 
 void ltft1Task() {
-    lastLtft1 = elmduino.longTermFuelTrimBank_1();
+    auto ltft1 = elmduino.longTermFuelTrimBank_1();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        ui_updateLtft1Label(lastLtft1);
-        queue_addToCSVQueue("ltft1", lastLtft1);
+        ltft1Received(ltft1);
     }
 }
 
 void ltft2Task() {
-    lastLtft2 = elmduino.longTermFuelTrimBank_2();
+    auto ltft2 = elmduino.longTermFuelTrimBank_2();
     if (elmduino.nb_rx_state == ELM_SUCCESS) {
-        ui_updateLtft2Label(lastLtft2);
-        queue_addToCSVQueue("ltft2", lastLtft2);
+        ltft2Received(ltft2);
     }
 }
 
@@ -134,24 +149,18 @@ void dtcTask() {
 }
 
 void testTask() {
-    auto kph = random(0, 100);
-    lastStft1 = random(-10,10);
-    lastStft2 = random(-10,10);
-    lastLtft1 = random(-10,10);
-    lastLtft2 = random(-10,10);
     auto dtc = random(0, 200);
 
-    ui_setSpeedValue(kph);
+    // Same handlers as live and replayed samples, so the chart gate and metrics run too
+    sampleMillis = millis();
+    kphReceived(random(0, 100));
+    rpmReceived(random(800, 4000));
+    absLoadReceived(random(20, 80));
+    stft1Received(random(-10,10));
+    stft2Received(random(-10,10));
+    ltft1Received(random(-10,10));
+    ltft2Received(random(-10,10));
     ui_updateWarningLabel("DTC: P"+ dtc);
-    ui_updateStft1Label(lastStft1);
-    ui_updateStft2Label(lastStft2);
-    ui_updateLtft1Label(lastLtft1);
-    ui_updateLtft2Label(lastLtft2);
-    ui_updateFuelTrimChart(lastStft1+lastLtft1, lastStft2 + lastLtft2);
-    queue_addToCSVQueue("stft1", lastStft1);
-    queue_addToCSVQueue("stft2", lastStft2);
-    queue_addToCSVQueue("ltft1", lastLtft1);
-    queue_addToCSVQueue("ltft2", lastLtft2);
 }
 
 #if DEBUG_WITH_SIMULATED_CAR
@@ -215,30 +224,34 @@ void finalizeTaskIfDone() {
         ui_updateWarningLabel(error_message.c_str());
         ui_loop();
         elmduino.printError();
+        fuelTrimFinished(fuelTrimFromName(currentTask->name));
         currentTask->lastRun = millis();
         currentTask = nullptr;
         delay(2000);
     }
 }
 
-void maybeSubmitFuelTrimChartChanges() {
-    boolean submitFuelTrimChartUpdate = true;
-    for (const auto &task: tasks) {
-        const auto isFuelTrimTask = task.name == "stft1" || task.name == "stft2" || task.name == "ltft1" || task.name == "ltft2";
-        if (isFuelTrimTask &&  task.lastRun < lastFuelTrimChartUpdate) {
-            submitFuelTrimChartUpdate = false; // We haven't received updates from all tasks yet
-            break;
-        }
-    }
-    if (submitFuelTrimChartUpdate) {
-        ui_updateFuelTrimChart(lastStft1 + lastLtft1, lastStft2 + lastLtft2);
-        lastFuelTrimChartUpdate = millis();
+String formatAccelResult(const AccelTimer &timer) {
+    return timer.hasResult ? String(timer.lastResultMillis / 1000.0f, 1) + "s" : String("-");
+}
+
+// Only the label runs on wall clock time, logging derived values is part of the sample handlers
+void maybeUpdateMetricsLabel() {
+    unsigned long currentMillis = millis();
+    if (currentMillis - lastMetricsLabelUpdate >= 500) {
+        String text = String(metrics_fuelFlowLitersPerHour(), 1) + " L/h  " + String(metrics_averageFuelEconomy(), 1) + " L/100\n"
+                      + "0-100 " + formatAccelResult(metricsZeroTo100) + "  "
+                      + "60-100 " + formatAccelResult(metricsInGear60To100) + "\n"
+                      + "B1-B2 " + (metrics_hasTrimImbalance() ? String(metrics_trimImbalance(), 1) + "%" : String("-"));
+        ui_updateMetricsLabel(text.c_str());
+        lastMetricsLabelUpdate = currentMillis;
     }
 }
 
 void executeOrPickNextTask() {
     unsigned long currentMillis = millis();
     if (currentTask != nullptr) {
+        sampleMillis = currentMillis;
         currentTask->function();
         finalizeTaskIfDone();
     } else {
@@ -258,6 +271,53 @@ void executeOrPickNextTask() {
     }
 }
 
+unsigned long replayUnknownSamples = 0;
+
+void replaySampleReceived(const ReplaySample &sample) {
+    if (!samples_dispatchLogged(sample.name, sample.value, sample.timestamp)) {
+        replayUnknownSamples++;
+    }
+}
+
+bool replayStarted = false;
+bool replayDoneReported = false;
+
+void replayLoop() {
+    if (!replayStarted) {
+        if (boot_isMarked(BOOT_SD_FAILED)) {
+            ui_updateWarningLabel("SD card failed, unable to replay " REPLAY_LOG_FILE);
+            replayStarted = true;
+            replayDoneReported = true;
+            return;
+        }
+        if (!boot_isMarked(BOOT_LOG_READY)) {
+            delay(5);
+            return; // SD is still being mounted in the background
+        }
+        replayStarted = true;
+        if (replay_begin(REPLAY_LOG_FILE, REPLAY_SPEED, replaySampleReceived)) {
+            ui_updateWarningLabel("Replaying " REPLAY_LOG_FILE);
+        } else {
+            ui_updateWarningLabel("Unable to open " REPLAY_LOG_FILE);
+            replayDoneReported = true;
+        }
+    }
+    // Don't replay faster than the SD card can write, otherwise the re-recorded log loses entries.
+    // Each replayed sample publishes one entry, plus the derived rows once per second of sample time.
+    int maxSamples = min(32, queue_spacesAvailable() - REPLAY_QUEUE_RESERVE);
+    if (maxSamples > 0) {
+        replay_loop(maxSamples);
+    }
+    if (replay_isFinished() && !replayDoneReported) {
+        String summary = String("Replay done: ") + replaySamplesDispatched + " samples, "
+                         + replayUnknownSamples + " unknown, " + replayLinesSkipped + " lines skipped, "
+                         + queueDroppedEntries + " log entries dropped";
+        ui_updateWarningLabel(summary.c_str());
+        Serial.println(summary);
+        replayDoneReported = true;
+    }
+}
+
 bool connectOBD() {
     Serial.println("Connecting");
     if (!elmduino.begin(SerialELM, false, 5000)) {
@@ -268,30 +328,56 @@ bool connectOBD() {
     return true;
 }
 
+volatile bool connected = false;
+
+// Runs on the other core, so the display stays responsive while ELM327 is being initialised
+void connectOBDTask(void *pvParameters) {
+    bool timelinePrinted = false;
+    while (!connectOBD()) {
+        if (!timelinePrinted) {
+            boot_printTimeline(); // Explains a slow boot even if the car never answers
+            timelinePrinted = true;
+        }
+        delay(200);
+    }
+    boot_mark(BOOT_OBD_CONNECTED);
+    boot_printTimeline();
+    connected = true;
+    vTaskDelete(NULL);
+}
+
 void setup() {
-    delay(500);
+    boot_setup();
+    boot_mark(BOOT_SETUP_STARTED);
     Serial.begin(115200);
     SerialELM.begin(38400, SERIAL_8N1, 15, 14);
-    ui_setup();
-    sd_setup();
+    if (!DEBUG_WITH_SIMULATED_CAR && !REPLAY_FROM_LOG) {
+        xTaskCreatePinnedToCore(connectOBDTask, "ConnectOBDTask", 4096, NULL, 1, NULL, 0);
+    }
     queue_setup();
+    ui_setup();
+    boot_mark(BOOT_DISPLAY_READY);
+    ui_updateWarningLabel(REPLAY_FROM_LOG ? "Mounting SD..." : "Connecting...");
 }
 
-bool connected = false;
+bool obdReady = false;
 
 void loop() {
     ui_loop();
-    if (!connected && !DEBUG_WITH_SIMULATED_CAR) {
-        ui_updateWarningLabel("Connecting...");
-        ui_loop();
-        connected = connectOBD();
-        if (connected) {
-            ui_updateWarningLabel("");
-        }
-        delay(200);
+    if (REPLAY_FROM_LOG) {
+        replayLoop();
+        maybeUpdateMetricsLabel();
         return;
     }
+    if (!obdReady && !DEBUG_WITH_SIMULATED_CAR) {
+        if (!connected) {
+            delay(5);
+            return;
+        }
+        obdReady = true;
+        ui_updateWarningLabel("");
+    }
 
     executeOrPickNextTask();
-    maybeSubmitFuelTrimChartChanges();
+    maybeUpdateMetricsLabel();
 }
@@ -0,0 +1,194 @@
+#pragma once
+/*
+ * Derived metrics - updated incrementally from each successful sample, O(1) per sample.
+ *
+ * Accumulators are fixed point, floats only appear when a value is read:
+ *  - trims and loads in 0.01 %
+ *  - fuel flow in microlitres per second, fuel used in nanolitres
+ *  - distance as km/h * ms (3600 of them make a metre)
+ */
+#include <stdint.h>
+
+#define METRICS_ENGINE_DISPLACEMENT_CC 1600
+#define METRICS_AIR_DENSITY_MG_PER_L 1184
+#define METRICS_STOICHIOMETRIC_AFR_X10 147
+#define METRICS_FUEL_DENSITY_MG_PER_ML 745
+// Longer gaps between samples (e.g. OBD errors) are not integrated into fuel used / distance
+#define METRICS_MAX_INTEGRATION_GAP_MS 2000
+// Acceleration run is aborted when speed drops this much below the highest speed of the run
+#define METRICS_ACCEL_ABORT_KPH 5
+// In-gear run is aborted when rpm/kph ratio drifts more than this (in %) from the start of the run
+#define METRICS_GEAR_RATIO_TOLERANCE_PERCENT 10
+
+typedef struct {
+    uint32_t count;
+    int64_t sum;
+    int64_t sumSquares;
+} TrimStats;
+
+typedef struct {
+    int32_t fromKph;
+    int32_t toKph;
+    bool requireSameGear;
+    bool armed;
+    bool running;
+    bool resultPending;
+    bool hasResult;
+    unsigned long startMillis;
+    int32_t maxKph;
+    int32_t startRpmPerKphX100;
+    unsigned long lastResultMillis;
+} AccelTimer;
+
+TrimStats metricsBank1Trim = {0, 0, 0};
+TrimStats metricsBank2Trim = {0, 0, 0};
+int32_t metricsLastBank1TrimCenti = 0;
+int32_t metricsLastBank2TrimCenti = 0;
+
+AccelTimer metricsZeroTo100 = {0, 100, false, false, false, false, false, 0, 0, 0, 0};
+AccelTimer metricsInGear60To100 = {60, 100, true, false, false, false, false, 0, 0, 0, 0};
+
+int32_t metricsLastKph = 0;
+int32_t metricsLastRpm = 0;
+int32_t metricsLastAbsLoadCenti = 0;
+int32_t metricsFuelFlowUlPerS = 0;
+int64_t metricsFuelUsedNl = 0;
+int64_t metricsDistanceKphMs = 0;
+unsigned long metricsLastKphMillis = 0;
+unsigned long metricsLastRpmMillis = 0;
+
+int32_t metrics_toCenti(float value) {
+    return (int32_t) (value >= 0 ? value * 100 + 0.5f : value * 100 - 0.5f);
+}
+
+unsigned long metrics_integrationStep(unsigned long &lastMillis, unsigned long now) {
+    unsigned long step = lastMillis == 0 || now < lastMillis ? 0 : now - lastMillis;
+    lastMillis = now;
+    return step > METRICS_MAX_INTEGRATION_GAP_MS ? 0 : step;
+}
+
+void trimStats_add(TrimStats &stats, int32_t trimCenti) {
+    stats.count++;
+    stats.sum += trimCenti;
+    stats.sumSquares += (int64_t) trimCenti * trimCenti;
+}
+
+float trimStats_mean(const TrimStats &stats) {
+    return stats.count == 0 ? 0 : (double) stats.sum / stats.count / 100;
+}
+
+float trimStats_variance(const TrimStats &stats) {
+    if (stats.count == 0) {
+        return 0;
+    }
+    double mean = (double) stats.sum / stats.count;
+    double variance = (double) stats.sumSquares / stats.count - mean * mean;
+    return variance > 0 ? variance / 10000 : 0;
+}
+
+void accelTimer_update(AccelTimer &timer, unsigned long now, int32_t kph, int32_t rpm) {
+    int32_t rpmPerKphX100 = kph > 0 ? rpm * 100 / kph : 0;
+    if (kph <= timer.fromKph) {
+        // Run starts at the last sample at or below the start speed
+        timer.armed = true;
+        timer.running = false;
+        timer.startMillis = now;
+        return;
+    }
+    if (!timer.running) {
+        if (!timer.armed) {
+            return;
+        }
+        timer.armed = false;
+        timer.running = true;
+        timer.maxKph = kph;
+        timer.startRpmPerKphX100 = rpmPerKphX100;
+    }
+    if (kph > timer.maxKph) {
+        timer.maxKph = kph;
+    }
+    bool slowedDown = kph < timer.maxKph - METRICS_ACCEL_ABORT_KPH;
+    bool gearChanged = false;
+    if (timer.requireSameGear && timer.startRpmPerKphX100 > 0 && rpmPerKphX100 > 0) {
+        int32_t drift = rpmPerKphX100 - timer.startRpmPerKphX100;
+        if (drift < 0) {
+            drift = -drift;
+        }
+        gearChanged = drift * 100 > timer.startRpmPerKphX100 * METRICS_GEAR_RATIO_TOLERANCE_PERCENT;
+    }
+    if (slowedDown || gearChanged) {
+        timer.running = false;
+        return;
+    }
+    if (kph >= timer.toKph) {
+        timer.running = false;
+        timer.lastResultMillis = now - timer.startMillis;
+        timer.resultPending = true;
+        timer.hasResult = true;
+    }
+}
+
+// Returns true once per finished run
+bool accelTimer_takeResult(AccelTimer &timer, unsigned long &resultMillis) {
+    if (!timer.resultPending) {
+        return false;
+    }
+    timer.resultPending = false;
+    resultMillis = timer.lastResultMillis;
+    return true;
+}
+
+// kph as reported by the car, without the display offset
+void metrics_addSpeed(unsigned long now, int32_t kph) {
+    metricsDistanceKphMs += (int64_t) metricsLastKph * metrics_integrationStep(metricsLastKphMillis, now);
+    metricsLastKph = kph;
+    accelTimer_update(metricsZeroTo100, now, kph, metricsLastRpm);
+    accelTimer_update(metricsInGear60To100, now, kph, metricsLastRpm);
+}
+
+void metrics_addAbsLoad(float absLoad) {
+    metricsLastAbsLoadCenti = metrics_toCenti(absLoad);
+}
+
+// Speed density estimate: air mass from absolute load and rpm, fuel from stoichiometric AFR corrected by trims
+void metrics_addRpm(unsigned long now, float rpm) {
+    metricsFuelUsedNl += (int64_t) metricsFuelFlowUlPerS * metrics_integrationStep(metricsLastRpmMillis, now);
+    metricsLastRpm = (int32_t) rpm;
+
+    int64_t airMgPerS = (int64_t) metricsLastAbsLoadCenti * METRICS_AIR_DENSITY_MG_PER_L * METRICS_ENGINE_DISPLACEMENT_CC
+                        * metricsLastRpm / (10000LL * 1000 * 120);
+    int64_t trimCenti = metricsBank2Trim.count == 0 ? metricsLastBank1TrimCenti
+                        : metricsBank1Trim.count == 0 ? metricsLastBank2TrimCenti
+                        : (metricsLastBank1TrimCenti + metricsLastBank2TrimCenti) / 2;
+    int64_t fuelMgPerS = airMgPerS * 10 * (10000 + trimCenti) / (METRICS_STOICHIOMETRIC_AFR_X10 * 10000LL);
+    metricsFuelFlowUlPerS = fuelMgPerS < 0 ? 0 : (int32_t) (fuelMgPerS * 1000 / METRICS_FUEL_DENSITY_MG_PER_ML);
+}
+
+// Total trim (short + long term) of a bank, only when both of its trims were read successfully
+void metrics_addBank1FuelTrim(float trim) {
+    metricsLastBank1TrimCenti = metrics_toCenti(trim);
+    trimStats_add(metricsBank1Trim, metricsLastBank1TrimCenti);
+}
+
+void metrics_addBank2FuelTrim(float trim) {
+    metricsLastBank2TrimCenti = metrics_toCenti(trim);
+    trimStats_add(metricsBank2Trim, metricsLastBank2TrimCenti);
+}
+
+// False until both banks have statistics, e.g. always on single bank engines
+bool metrics_hasTrimImbalance() {
+    return metricsBank1Trim.count > 0 && metricsBank2Trim.count > 0;
+}
+
+float metrics_trimImbalance() {
+    return trimStats_mean(metricsBank1Trim) - trimStats_mean(metricsBank2Trim);
+}
+
+float metrics_fuelFlowLitersPerHour() {
+    return metricsFuelFlowUlPerS * 3600.0f / 1000000;
+}
+
+// L/100km since start, 0 until the car has moved
+float metrics_averageFuelEconomy() {
+    return metricsDistanceKphMs == 0 ? 0 : metricsFuelUsedNl * 0.36 / metricsDistanceKphMs;
+}
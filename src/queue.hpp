@@ -2,13 +2,17 @@
 
 typedef struct {
     unsigned long timestamp;
-    char name[10];
+    char name[16];
     char value[10];
 } CsvEntry;
 
 QueueHandle_t csvEntriesQueue = nullptr;
+unsigned long queueDroppedEntries = 0;
 
 void queue_consumeCSVQueue(void * pvParameters) {
+    // Mount SD and create the log here, off the boot path. Entries published meanwhile wait in the queue.
+    sd_setup();
+    boot_mark(logFileName.isEmpty() ? BOOT_SD_FAILED : BOOT_LOG_READY);
     String bufferToWrite = "";
     CsvEntry entry;
     auto entriesCollected = 0;
@@ -33,29 +37,39 @@ void queue_consumeCSVQueue(void * pvParameters) {
     }
 }
 
-void queue_addToCSVQueue(const char *name, const char *value) {
+void queue_addToCSVQueue(const char *name, const char *value, unsigned long timestamp = millis()) {
     CsvEntry entry;
-    entry.timestamp = millis();
-    strncpy(entry.name, name, 10);
-    strncpy(entry.value, value, 10);
+    entry.timestamp = timestamp;
+    strncpy(entry.name, name, sizeof(entry.name) - 1);
+    entry.name[sizeof(entry.name) - 1] = '\0';
+    strncpy(entry.value, value, sizeof(entry.value) - 1);
+    entry.value[sizeof(entry.value) - 1] = '\0';
     int publishResult = xQueueSend(csvEntriesQueue, (void *)&entry, 0);
     if (publishResult == pdTRUE) {
         // The message was successfully sent.
     } else if (publishResult == errQUEUE_FULL) {
-        ui_updateWarningLabel("SD queue full!");
-        Serial.println("SD queue full!");
+        // Count drops and only report every 100th, so a full queue doesn't keep overwriting the warning label
+        if (queueDroppedEntries++ % 100 == 0) {
+            String message = String("SD queue full! ") + queueDroppedEntries + " dropped";
+            ui_updateWarningLabel(message.c_str());
+            Serial.println(message);
+        }
     } else {
         ui_updateWarningLabel("Failed to send to CSV queue!");
         Serial.println("Failed to send to CSV queue!");
     }
 }
 
-void queue_addToCSVQueue(const char *name, const float value) {
-    queue_addToCSVQueue(name, String(value).c_str());
+void queue_addToCSVQueue(const char *name, const float value, unsigned long timestamp = millis()) {
+    queue_addToCSVQueue(name, String(value).c_str(), timestamp);
+}
+
+void queue_addToCSVQueue(const char *name, const int value, unsigned long timestamp = millis()) {
+    queue_addToCSVQueue(name, String(value).c_str(), timestamp);
 }
 
-void queue_addToCSVQueue(const char *name, const int value) {
-    queue_addToCSVQueue(name, String(value).c_str());
+int queue_spacesAvailable() {
+    return csvEntriesQueue == nullptr ? 0 : uxQueueSpacesAvailable(csvEntriesQueue);
 }
 
 
@@ -67,5 +81,5 @@ void queue_setup() {
             delay(1000);  // Halt at this point as is not possible to continue
         }
     }
-    xTaskCreatePinnedToCore(queue_consumeCSVQueue, "ConsumeQueueTask", 4096, NULL, 1, NULL, 1);
+    xTaskCreatePinnedToCore(queue_consumeCSVQueue, "ConsumeQueueTask", 8192, NULL, 1, NULL, 1);
 }
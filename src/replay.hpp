@@ -0,0 +1,185 @@
+#pragma once
+/*
+ * Trip replay - feeds a recorded /N.csv log ("timestamp;name;value" lines) back
+ * through the same sample handlers as live OBD data.
+ *
+ * Speed: 1 = real time, N = N times faster, 0 = as fast as possible.
+ * Works on the board (reads from SD) and in the native build (reads with stdio).
+ */
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#include "FS.h"
+#include "SD.h"
+#else
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+typedef struct {
+    unsigned long timestamp;
+    char name[16];
+    float value;
+} ReplaySample;
+
+typedef void (*ReplaySampleHandler)(const ReplaySample &sample);
+
+#ifdef ARDUINO
+File replayFile;
+#else
+FILE *replayFile = nullptr;
+#endif
+ReplaySampleHandler replaySampleHandler = nullptr;
+float replaySpeed = 1.0f;
+unsigned long replayStartMillis = 0;
+unsigned long replayFirstTimestamp = 0;
+unsigned long replaySamplesDispatched = 0;
+unsigned long replayLinesSkipped = 0;
+ReplaySample replayPendingSample;
+bool replayHasPendingSample = false;
+bool replayFinished = true;
+
+unsigned long replay_millis() {
+#ifdef ARDUINO
+    return millis();
+#else
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+#endif
+}
+
+bool replay_readLine(char *buffer, size_t bufferSize) {
+#ifdef ARDUINO
+    if (!replayFile || !replayFile.available()) {
+        return false;
+    }
+    size_t length = replayFile.readBytesUntil('\n', buffer, bufferSize - 1);
+#else
+    if (replayFile == nullptr || fgets(buffer, bufferSize, replayFile) == nullptr) {
+        return false;
+    }
+    size_t length = strlen(buffer);
+#endif
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r')) {
+        length--;
+    }
+    buffer[length] = '\0';
+    return true;
+}
+
+// Logs written before CsvEntry.name was null terminated have 10 character names run into the value,
+// e.g. "1234;engineload12.3;12.3". The name is cut back to 10 characters in that case.
+#define REPLAY_LEGACY_NAME_LENGTH 10
+
+bool replay_parseLine(const char *line, ReplaySample &sample) {
+    char *end;
+    sample.timestamp = strtoul(line, &end, 10);
+    if (end == line || *end != ';') {
+        return false;
+    }
+    const char *name = end + 1;
+    const char *separator = strchr(name, ';');
+    if (separator == nullptr || separator == name) {
+        return false;
+    }
+    const char *value = separator + 1;
+    size_t nameLength = separator - name;
+    if (nameLength > REPLAY_LEGACY_NAME_LENGTH && nameLength - REPLAY_LEGACY_NAME_LENGTH == strlen(value)
+        && strncmp(name + REPLAY_LEGACY_NAME_LENGTH, value, strlen(value)) == 0) {
+        nameLength = REPLAY_LEGACY_NAME_LENGTH;
+    }
+    if (nameLength >= sizeof(sample.name)) {
+        return false;
+    }
+    memcpy(sample.name, name, nameLength);
+    sample.name[nameLength] = '\0';
+    sample.value = strtof(value, &end);
+    return end != value;
+}
+
+// The only format specific part - a binary log reader would replace this function.
+bool replay_readNextSample(ReplaySample &sample) {
+    char line[64];
+    while (replay_readLine(line, sizeof(line))) {
+        if (replay_parseLine(line, sample)) {
+            return true;
+        }
+        if (line[0] != '\0') {
+            replayLinesSkipped++;
+        }
+    }
+    return false;
+}
+
+void replay_stop() {
+#ifdef ARDUINO
+    if (replayFile) {
+        replayFile.close();
+    }
+#else
+    if (replayFile != nullptr) {
+        fclose(replayFile);
+        replayFile = nullptr;
+    }
+#endif
+    replayHasPendingSample = false;
+    replayFinished = true;
+}
+
+bool replay_begin(const char *path, float speed, ReplaySampleHandler handler) {
+    replay_stop();
+#ifdef ARDUINO
+    replayFile = SD.open(path, FILE_READ);
+    if (!replayFile) {
+#else
+    replayFile = fopen(path, "r");
+    if (replayFile == nullptr) {
+#endif
+        return false;
+    }
+    replaySampleHandler = handler;
+    replaySpeed = speed;
+    replaySamplesDispatched = 0;
+    replayLinesSkipped = 0;
+    replayFinished = false;
+    replayHasPendingSample = replay_readNextSample(replayPendingSample);
+    if (!replayHasPendingSample) {
+        replay_stop();
+        return true;
+    }
+    replayFirstTimestamp = replayPendingSample.timestamp;
+    replayStartMillis = replay_millis();
+    return true;
+}
+
+bool replay_isSampleDue(const ReplaySample &sample) {
+    if (replaySpeed <= 0 || sample.timestamp < replayFirstTimestamp) {
+        return true;
+    }
+    unsigned long elapsed = replay_millis() - replayStartMillis;
+    unsigned long recordedElapsed = sample.timestamp - replayFirstTimestamp;
+    return recordedElapsed / replaySpeed <= elapsed;
+}
+
+// Dispatches up to maxSamples samples that are due. Returns number of dispatched samples.
+int replay_loop(int maxSamples = 32) {
+    int dispatched = 0;
+    while (replayHasPendingSample && dispatched < maxSamples && replay_isSampleDue(replayPendingSample)) {
+        if (replaySampleHandler != nullptr) {
+            replaySampleHandler(replayPendingSample);
+        }
+        dispatched++;
+        replaySamplesDispatched++;
+        replayHasPendingSample = replay_readNextSample(replayPendingSample);
+    }
+    if (!replayHasPendingSample && !replayFinished) {
+        replay_stop();
+    }
+    return dispatched;
+}
+
+bool replay_isFinished() {
+    return replayFinished;
+}
@@ -0,0 +1,121 @@
+/*
+ * Native (Linux) trip replay - `pio run -e native` and then
+ *   .pio/build/native/program /path/to/N.csv [speed]
+ *
+ * Speed: 1 = real time, N = N times faster, 0 (default) = as fast as possible.
+ * Samples go through the same handlers as on the board (samples.hpp: fuel trim gate,
+ * metrics, logging of samples and derived values); only the display and the SD queue
+ * are stubbed with counters, and the metrics label from main.cpp doesn't run. Prints sample
+ * statistics, metrics and throughput, so runs are deterministic and can be compared
+ * between builds without a car.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "replay.hpp"
+
+// No display or SD card on the host - count what would have been drawn / written
+static unsigned long uiUpdates = 0;
+static unsigned long chartPoints = 0;
+static unsigned long logEntries = 0;
+
+void ui_setSpeedValue(int32_t) { uiUpdates++; }
+void ui_updateStft1Label(float) { uiUpdates++; }
+void ui_updateStft2Label(float) { uiUpdates++; }
+void ui_updateLtft1Label(float) { uiUpdates++; }
+void ui_updateLtft2Label(float) { uiUpdates++; }
+void ui_updateFuelTrimChart(int, int) { chartPoints++; }
+void queue_addToCSVQueue(const char *, const float, unsigned long) { logEntries++; }
+void queue_addToCSVQueue(const char *, const int, unsigned long) { logEntries++; }
+
+#include "samples.hpp"
+
+typedef struct {
+    char name[16];
+    unsigned long count;
+    float min;
+    float max;
+    float last;
+} NativeSampleStats;
+
+static NativeSampleStats sampleStats[32];
+static int sampleStatsCount = 0;
+static unsigned long unknownSamples = 0;
+
+void nativeSampleReceived(const ReplaySample &sample) {
+    NativeSampleStats *stats = nullptr;
+    for (int i = 0; i < sampleStatsCount; i++) {
+        if (strcmp(sampleStats[i].name, sample.name) == 0) {
+            stats = &sampleStats[i];
+            break;
+        }
+    }
+    if (stats == nullptr) {
+        if (sampleStatsCount == 32) {
+            return;
+        }
+        stats = &sampleStats[sampleStatsCount++];
+        strcpy(stats->name, sample.name);
+        stats->count = 0;
+        stats->min = sample.value;
+        stats->max = sample.value;
+    }
+    stats->count++;
+    stats->min = sample.value < stats->min ? sample.value : stats->min;
+    stats->max = sample.value > stats->max ? sample.value : stats->max;
+    stats->last = sample.value;
+    if (!samples_dispatchLogged(sample.name, sample.value, sample.timestamp)) {
+        unknownSamples++;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s <log.csv> [speed]\n", argv[0]);
+        return 1;
+    }
+    float speed = argc > 2 ? strtof(argv[2], nullptr) : 0;
+    if (!replay_begin(argv[1], speed, nativeSampleReceived)) {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (!replay_isFinished()) {
+        if (replay_loop() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%-10s %8s %10s %10s %10s\n", "name", "count", "min", "max", "last");
+    for (int i = 0; i < sampleStatsCount; i++) {
+        const auto &stats = sampleStats[i];
+        printf("%-10s %8lu %10.2f %10.2f %10.2f\n", stats.name, stats.count, stats.min, stats.max, stats.last);
+    }
+    char imbalance[16] = "-";
+    if (metrics_hasTrimImbalance()) {
+        snprintf(imbalance, sizeof(imbalance), "%.2f%%", metrics_trimImbalance());
+    }
+    printf("Trim bank1 mean %.2f%% var %.2f (%u sets), bank2 mean %.2f%% var %.2f (%u sets), imbalance %s\n",
+           trimStats_mean(metricsBank1Trim), trimStats_variance(metricsBank1Trim), metricsBank1Trim.count,
+           trimStats_mean(metricsBank2Trim), trimStats_variance(metricsBank2Trim), metricsBank2Trim.count, imbalance);
+    char zeroTo100[16] = "-";
+    char inGear60To100[16] = "-";
+    if (metricsZeroTo100.hasResult) {
+        snprintf(zeroTo100, sizeof(zeroTo100), "%.1fs", metricsZeroTo100.lastResultMillis / 1000.0f);
+    }
+    if (metricsInGear60To100.hasResult) {
+        snprintf(inGear60To100, sizeof(inGear60To100), "%.1fs", metricsInGear60To100.lastResultMillis / 1000.0f);
+    }
+    printf("0-100 %s, 60-100 in gear %s, fuel %.1f L/100km\n", zeroTo100, inGear60To100, metrics_averageFuelEconomy());
+    printf("Label updates %lu, chart points %lu, log entries %lu\n", uiUpdates, chartPoints, logEntries);
+    printf("Replayed %lu samples in %.3f ms", replaySamplesDispatched, elapsedUs / 1000.0);
+    if (elapsedUs > 0) {
+        printf(" (%.0f samples/s)", replaySamplesDispatched * 1000000.0 / elapsedUs);
+    }
+    printf("\n");
+    printf("Skipped %lu unparseable lines, %lu samples with unknown names\n", replayLinesSkipped, unknownSamples);
+    return 0;
+}
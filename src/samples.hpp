@@ -0,0 +1,199 @@
+#pragma once
+/*
+ * Sample handlers - shared by live OBD tasks, trip replay on the board and the native replay tool.
+ *
+ * No Arduino dependency: the includer provides ui_setSpeedValue, ui_update*Label,
+ * ui_updateFuelTrimChart and queue_addToCSVQueue (ui.hpp / queue.hpp on the board, stubs natively).
+ * Everything here runs on sample time (sampleMillis), so a replay logs the same rows at any speed.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "metrics.hpp"
+
+// Speed is displayed and logged this much above what the car reports
+#define KPH_DISPLAY_OFFSET 3
+
+#define FUEL_TRIM_STFT1 0x1
+#define FUEL_TRIM_STFT2 0x2
+#define FUEL_TRIM_LTFT1 0x4
+#define FUEL_TRIM_LTFT2 0x8
+#define FUEL_TRIM_ALL 0xF
+
+float lastStft1 = 0;
+float lastStft2 = 0;
+float lastLtft1 = 0;
+float lastLtft2 = 0;
+uint8_t fuelTrimsFinished = 0; // Trims received (or failed) since the last chart point
+uint8_t fuelTrimsReceived = 0; // Trims received successfully since the last chart point
+unsigned long sampleMillis = 0; // When the sample being handled was taken (recorded time when replaying)
+unsigned long lastMetricsLoggedMillis = 0;
+bool metricsLogStarted = false;
+
+// Derived values go to the log once per second of sample time, acceleration runs as soon as they finish
+void logDerivedMetrics() {
+    unsigned long resultMillis;
+    if (accelTimer_takeResult(metricsZeroTo100, resultMillis)) {
+        queue_addToCSVQueue("t0_100", (int) resultMillis, sampleMillis);
+    }
+    if (accelTimer_takeResult(metricsInGear60To100, resultMillis)) {
+        queue_addToCSVQueue("t60_100", (int) resultMillis, sampleMillis);
+    }
+    if (!metricsLogStarted) {
+        metricsLogStarted = true;
+        lastMetricsLoggedMillis = sampleMillis;
+        return;
+    }
+    if (sampleMillis - lastMetricsLoggedMillis < 1000) {
+        return;
+    }
+    queue_addToCSVQueue("trim1mean", trimStats_mean(metricsBank1Trim), sampleMillis);
+    queue_addToCSVQueue("trim1var", trimStats_variance(metricsBank1Trim), sampleMillis);
+    queue_addToCSVQueue("trim2mean", trimStats_mean(metricsBank2Trim), sampleMillis);
+    queue_addToCSVQueue("trim2var", trimStats_variance(metricsBank2Trim), sampleMillis);
+    if (metrics_hasTrimImbalance()) {
+        queue_addToCSVQueue("trimimbal", metrics_trimImbalance(), sampleMillis);
+    }
+    queue_addToCSVQueue("fuelflow", metrics_fuelFlowLitersPerHour(), sampleMillis);
+    queue_addToCSVQueue("fuelavg", metrics_averageFuelEconomy(), sampleMillis);
+    lastMetricsLoggedMillis = sampleMillis;
+}
+
+// One chart point per complete set of four trims. Failed trims count as finished, so cars
+// without bank 2 still get a chart, but a bank only goes into the trim statistics when both
+// of its trims were received in this set.
+void fuelTrimFinished(uint8_t trim) {
+    fuelTrimsFinished |= trim;
+    if (fuelTrimsFinished != FUEL_TRIM_ALL) {
+        return;
+    }
+    ui_updateFuelTrimChart(lastStft1 + lastLtft1, lastStft2 + lastLtft2);
+    if ((fuelTrimsReceived & (FUEL_TRIM_STFT1 | FUEL_TRIM_LTFT1)) == (FUEL_TRIM_STFT1 | FUEL_TRIM_LTFT1)) {
+        metrics_addBank1FuelTrim(lastStft1 + lastLtft1);
+    }
+    if ((fuelTrimsReceived & (FUEL_TRIM_STFT2 | FUEL_TRIM_LTFT2)) == (FUEL_TRIM_STFT2 | FUEL_TRIM_LTFT2)) {
+        metrics_addBank2FuelTrim(lastStft2 + lastLtft2);
+    }
+    fuelTrimsFinished = 0;
+    fuelTrimsReceived = 0;
+}
+
+void fuelTrimReceived(uint8_t trim) {
+    fuelTrimsReceived |= trim;
+    fuelTrimFinished(trim);
+}
+
+uint8_t fuelTrimFromName(const char *name) {
+    if (strcmp(name, "stft1") == 0) {
+        return FUEL_TRIM_STFT1;
+    } else if (strcmp(name, "stft2") == 0) {
+        return FUEL_TRIM_STFT2;
+    } else if (strcmp(name, "ltft1") == 0) {
+        return FUEL_TRIM_LTFT1;
+    } else if (strcmp(name, "ltft2") == 0) {
+        return FUEL_TRIM_LTFT2;
+    }
+    return 0;
+}
+
+// kph as reported by the car
+void kphReceived(int32_t kph) {
+    ui_setSpeedValue(kph + KPH_DISPLAY_OFFSET);
+    queue_addToCSVQueue("kph", kph + KPH_DISPLAY_OFFSET, sampleMillis);
+    metrics_addSpeed(sampleMillis, kph);
+    logDerivedMetrics();
+}
+
+void rpmReceived(float rpm) {
+    queue_addToCSVQueue("rpm", rpm, sampleMillis);
+    metrics_addRpm(sampleMillis, rpm);
+    logDerivedMetrics();
+}
+
+void ectReceived(float ect) {
+    queue_addToCSVQueue("ect", ect, sampleMillis);
+    logDerivedMetrics();
+}
+
+void absLoadReceived(float absLoad) {
+    queue_addToCSVQueue("absload", absLoad, sampleMillis);
+    metrics_addAbsLoad(absLoad);
+    logDerivedMetrics();
+}
+
+void engineLoadReceived(float engineLoad) {
+    queue_addToCSVQueue("engineload", engineLoad, sampleMillis);
+    logDerivedMetrics();
+}
+
+void stft1Received(float stft1) {
+    lastStft1 = stft1;
+    ui_updateStft1Label(lastStft1);
+    queue_addToCSVQueue("stft1", lastStft1, sampleMillis);
+    fuelTrimReceived(FUEL_TRIM_STFT1);
+    logDerivedMetrics();
+}
+
+void stft2Received(float stft2) {
+    lastStft2 = stft2;
+    ui_updateStft2Label(lastStft2);
+    queue_addToCSVQueue("stft2", lastStft2, sampleMillis);
+    fuelTrimReceived(FUEL_TRIM_STFT2);
+    logDerivedMetrics();
+}
+
+void ltft1Received(float ltft1) {
+    lastLtft1 = ltft1;
+    ui_updateLtft1Label(lastLtft1);
+    queue_addToCSVQueue("ltft1", lastLtft1, sampleMillis);
+    fuelTrimReceived(FUEL_TRIM_LTFT1);
+    logDerivedMetrics();
+}
+
+void ltft2Received(float ltft2) {
+    lastLtft2 = ltft2;
+    ui_updateLtft2Label(lastLtft2);
+    queue_addToCSVQueue("ltft2", lastLtft2, sampleMillis);
+    fuelTrimReceived(FUEL_TRIM_LTFT2);
+    logDerivedMetrics();
+}
+
+// Written to the log from derived values, a replay recomputes them instead
+static const char *derivedSampleNames[] = {
+    "ttfs", "boot_setup", "boot_display", "boot_log", "boot_sdfail", "boot_obd", "t0_100", "t60_100", "trim1mean", "trim1var", "trim2mean", "trim2var", "trimimbal", "fuelflow", "fuelavg",
+};
+
+bool isDerivedSampleName(const char *name) {
+    for (const auto derivedName: derivedSampleNames) {
+        if (strcmp(name, derivedName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Routes a sample as written to the log. Returns false for names without a handler.
+bool samples_dispatchLogged(const char *name, float value, unsigned long timestamp) {
+    sampleMillis = timestamp;
+    if (strcmp(name, "kph") == 0) {
+        kphReceived((int32_t) value - KPH_DISPLAY_OFFSET);
+    } else if (strcmp(name, "rpm") == 0) {
+        rpmReceived(value);
+    } else if (strcmp(name, "ect") == 0) {
+        ectReceived(value);
+    } else if (strcmp(name, "absload") == 0) {
+        absLoadReceived(value);
+    } else if (strcmp(name, "engineload") == 0) {
+        engineLoadReceived(value);
+    } else if (strcmp(name, "stft1") == 0) {
+        stft1Received(value);
+    } else if (strcmp(name, "stft2") == 0) {
+        stft2Received(value);
+    } else if (strcmp(name, "ltft1") == 0) {
+        ltft1Received(value);
+    } else if (strcmp(name, "ltft2") == 0) {
+        ltft2Received(value);
+    } else {
+        return isDerivedSampleName(name);
+    }
+    return true;
+}
@@ -12,6 +12,7 @@ static lv_obj_t *ui_stft1Label;
 static lv_obj_t *ui_stft2Label;
 static lv_obj_t *ui_ltft1Label;
 static lv_obj_t *ui_ltft2Label;
+static lv_obj_t *ui_metricsLabel;
 
 void ui_setSpeedValue(int32_t value)
 {
@@ -33,6 +34,11 @@ void ui_updateFuelTrimChart(int bank1Value, int bank2Value)
     lv_chart_set_next_value(ui_fuelTrimChart, ui_fuelTrimChartBank2Series, bank2Value);
 }
 
+void ui_updateMetricsLabel(const char* text)
+{
+    lv_label_set_text(ui_metricsLabel, text);
+}
+
 inline void updateFuelTrimLabel(lv_obj_t* label, const char* trimName, float trim)
 {
     if (trim > 10.0f || trim < -10.0f) {
@@ -173,6 +179,17 @@ void ui_setup()
     lv_obj_set_style_text_color(ui_Label8, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
     lv_obj_set_style_text_opa(ui_Label8, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
 
+    ui_metricsLabel = lv_label_create(ui_speedArc);
+    lv_obj_set_width(ui_metricsLabel, LV_SIZE_CONTENT);   /// 1
+    lv_obj_set_height(ui_metricsLabel, LV_SIZE_CONTENT);    /// 1
+    lv_obj_set_x(ui_metricsLabel, 0);
+    lv_obj_set_y(ui_metricsLabel, 40);
+    lv_obj_set_align(ui_metricsLabel, LV_ALIGN_CENTER);
+    lv_label_set_text(ui_metricsLabel, "");
+    lv_obj_set_style_text_color(ui_metricsLabel, lv_color_hex(0x8D8D8D), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_opa(ui_metricsLabel, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_align(ui_metricsLabel, LV_TEXT_ALIGN_CENTER, LV_PART_MAIN | LV_STATE_DEFAULT);
+
     ui_ltft1Label = lv_label_create(lv_scr_act());
     lv_obj_set_width(ui_ltft1Label, 140);
     lv_obj_set_height(ui_ltft1Label, LV_SIZE_CONTENT);    /// 64